@@ -2,6 +2,9 @@ TEMPLATE = app
 CONFIG += console
 CONFIG -= qt
 
+QMAKE_CXXFLAGS += -std=c++11 -pthread
+LIBS += -pthread
+
 SOURCES += main.cpp
 
 HEADERS +=
@@ -21,6 +21,20 @@
 #include <limits>
 #include <list>
 #include <vector>
+#include <deque>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 using namespace std;
 
@@ -131,7 +145,7 @@ private:
         }
     }
 
-    list<unsigned> GetListOfNeighbors()
+    list<unsigned> GetListOfNeighbors() const
     {
         list<unsigned> luListOfNeighbors;
         list<SEdge>::const_iterator ciEdges = m_listEdges.begin();
@@ -143,6 +157,19 @@ private:
         return luListOfNeighbors;
     }
 
+    vector< pair<unsigned, double> > GetVectorOfNeighborEdges() const
+    {
+        vector< pair<unsigned, double> > vecNeighborEdges;
+        vecNeighborEdges.reserve(m_listEdges.size());
+        list<SEdge>::const_iterator ciEdges = m_listEdges.begin();
+        while(ciEdges != m_listEdges.end())
+        {
+            vecNeighborEdges.push_back(make_pair(ciEdges->m_uToVertex, ciEdges->m_dValue));
+            ++ciEdges;
+        }
+        return vecNeighborEdges;
+    }
+
     struct SEdge
     {
         SEdge(const unsigned &uToVertex, const double &dValue):
@@ -249,12 +276,19 @@ public:
         m_vectorOfVertices[uFromVertex].SetValueOfEdgeTo(uToVertex, dValue);
     }
 
-    list<unsigned> GetListOfNeighborVertices(const unsigned &uFromVertex)
+    list<unsigned> GetListOfNeighborVertices(const unsigned &uFromVertex) const
     {
         CASSERT::ASSERT_CONDITION("CGraph::GetListOfNeighborVertices() parameter \"uFromVertex\" out of range", uFromVertex<m_uNumberOfVertices);
 
         return m_vectorOfVertices[uFromVertex].GetListOfNeighbors();
     }
+
+    vector< pair<unsigned, double> > GetVectorOfNeighborEdges(const unsigned &uFromVertex) const // Pairs of neighbor vertex and edge value.
+    {
+        CASSERT::ASSERT_CONDITION("CGraph::GetVectorOfNeighborEdges() parameter \"uFromVertex\" out of range", uFromVertex<m_uNumberOfVertices);
+
+        return m_vectorOfVertices[uFromVertex].GetVectorOfNeighborEdges();
+    }
 private:
     unsigned m_uNumberOfVertices;
     unsigned m_uNumberOfEdges;
@@ -262,6 +296,235 @@ private:
 };
 
 
+// Read-only compressed graph. Built once, either from "CGraph" or vertex by vertex with "AppendVertex"
+// (so that a "CGraph" never has to exist), and never changed afterwards.
+// Neighbors of every vertex are sorted, delta-encoded and packed with "Stream VByte" scheme:
+// 2-bit control codes (byte length - 1 of every value, four codes per control byte) followed by the data bytes.
+// Byte stream ends with "m_cuBytePadding" zero bytes, so a 16-byte SIMD load of the data of any vertex
+// stays inside the buffer. Decoding is done byte by byte here.
+// Edge values are stored as doubles or, optionally, quantized to 16 bits relative to the distance range.
+// Use "CNeighborIterator" to walk through neighbors of a vertex.
+class CCompressedGraph
+{
+public:
+    // Decoding iterator over neighbors of one vertex (in ascending order).
+    class CNeighborIterator
+    {
+    public:
+        bool IsEnd() const
+        {
+            return m_uIndex == m_uNumberOfNeighbors;
+        }
+
+        unsigned GetVertex() const // Returns the current neighbor vertex.
+        {
+            return m_uVertex;
+        }
+
+        double GetEdgeValue() const // Returns the value of the edge to the current neighbor vertex.
+        {
+            return m_pGraph->GetEdgeValueAt(m_uFirstEdge + m_uIndex);
+        }
+
+        void Next()
+        {
+            ++m_uIndex;
+            if(!IsEnd()) DecodeNeighbor();
+        }
+
+    private:
+        friend class CCompressedGraph;
+        CNeighborIterator(const CCompressedGraph *pGraph, const unsigned &cuVertex):
+            m_pGraph(pGraph), m_pControl(pGraph->GetBytes() + pGraph->m_vecuByteOffsets[cuVertex]),
+            m_pData(m_pControl + (pGraph->GetNumberOfNeighbors(cuVertex) + 3) / 4),
+            m_uFirstEdge(pGraph->m_vecuEdgeOffsets[cuVertex]), m_uNumberOfNeighbors(pGraph->GetNumberOfNeighbors(cuVertex)),
+            m_uIndex(0), m_uVertex(0)
+        {
+            if(!IsEnd()) DecodeNeighbor();
+        }
+
+        void DecodeNeighbor()
+        {
+            unsigned uLength = ((m_pControl[m_uIndex >> 2] >> ((m_uIndex & 3) << 1)) & 3) + 1;
+            unsigned uDelta = 0;
+            for(unsigned uByte = 0; uByte < uLength; ++uByte)
+            {
+                uDelta |= static_cast<unsigned>(m_pData[uByte]) << (8 * uByte);
+            }
+            m_pData += uLength;
+            m_uVertex += uDelta;
+        }
+
+        const CCompressedGraph *m_pGraph;
+        const unsigned char *m_pControl;
+        const unsigned char *m_pData;
+        unsigned m_uFirstEdge;
+        unsigned m_uNumberOfNeighbors;
+        unsigned m_uIndex;
+        unsigned m_uVertex;
+    };
+
+    // "cdQuantizationRange" is the upper bound of edge values (usually "cdDistanceRange" of the generator).
+    // Value 0 keeps edge values as full doubles.
+    explicit CCompressedGraph(const CGraph &Graph, const double &cdQuantizationRange = 0.0):
+        m_uNumberOfVertices(Graph.GetNumberOfVertices()),
+        m_bQuantized(cdQuantizationRange > 0.0), m_dQuantizationStep(cdQuantizationRange / m_cuMaxQuantizedValue)
+    {
+        Initialize(cdQuantizationRange);
+        for(unsigned uVertex = 0; uVertex < m_uNumberOfVertices; ++uVertex)
+        {
+            vector< pair<unsigned, double> > vecNeighbors = Graph.GetVectorOfNeighborEdges(uVertex);
+            sort(vecNeighbors.begin(), vecNeighbors.end());
+            AppendVertex(vecNeighbors);
+        }
+    }
+
+    // Empty graph of "cuNumberOfVertices" vertices. Vertices must be appended in order with "AppendVertex"
+    // before the graph is used.
+    CCompressedGraph(const unsigned &cuNumberOfVertices, const double &cdQuantizationRange):
+        m_uNumberOfVertices(cuNumberOfVertices),
+        m_bQuantized(cdQuantizationRange > 0.0), m_dQuantizationStep(cdQuantizationRange / m_cuMaxQuantizedValue)
+    {
+        Initialize(cdQuantizationRange);
+    }
+
+    // Appends the next vertex with its neighbors (pairs of neighbor vertex and edge value, sorted by vertex).
+    // Every edge must be given from both of its ends.
+    void AppendVertex(const vector< pair<unsigned, double> > &vecNeighbors)
+    {
+        CASSERT::ASSERT_CONDITION("CCompressedGraph::AppendVertex() all vertices are already appended", GetNumberOfAppendedVertices() < m_uNumberOfVertices);
+
+        CASSERT::ASSERT_CONDITION("CCompressedGraph::AppendVertex() graph is too large",
+                                  (vecNeighbors.size() <= numeric_limits<unsigned>::max() - m_vecuEdgeOffsets.back()) &&
+                                  (5 * vecNeighbors.size() <= numeric_limits<unsigned>::max() - m_vecucBytes.size()));
+
+        m_vecucBytes.resize(m_vecucBytes.size() - m_cuBytePadding);
+        EncodeNeighbors(vecNeighbors);
+        m_vecucBytes.resize(m_vecucBytes.size() + m_cuBytePadding, 0);
+
+        m_vecuEdgeOffsets.push_back(m_vecuEdgeOffsets.back() + static_cast<unsigned>(vecNeighbors.size()));
+        m_vecuByteOffsets.push_back(static_cast<unsigned>(m_vecucBytes.size() - m_cuBytePadding));
+    }
+
+    unsigned GetNumberOfVertices() const // Returns the number of vertices in the graph.
+    {
+        return m_uNumberOfVertices;
+    }
+
+    unsigned GetNumberOfEdges() const // Returns the number of edges in the graph.
+    {
+        return m_vecuEdgeOffsets.back() / 2;
+    }
+
+    unsigned GetNumberOfNeighbors(const unsigned &uVertex) const
+    {
+        CASSERT::ASSERT_CONDITION("CCompressedGraph::GetNumberOfNeighbors() parameter \"uVertex\" out of range", uVertex<GetNumberOfAppendedVertices());
+
+        return m_vecuEdgeOffsets[uVertex + 1] - m_vecuEdgeOffsets[uVertex];
+    }
+
+    CNeighborIterator GetNeighborIterator(const unsigned &uVertex) const
+    {
+        CASSERT::ASSERT_CONDITION("CCompressedGraph::GetNeighborIterator() parameter \"uVertex\" out of range", uVertex<GetNumberOfAppendedVertices());
+
+        return CNeighborIterator(this, uVertex);
+    }
+
+    size_t GetMemoryUsage() const // Returns the number of bytes used by adjacency data.
+    {
+        return m_vecucBytes.size() * sizeof(unsigned char) +
+                (m_vecuEdgeOffsets.size() + m_vecuByteOffsets.size()) * sizeof(unsigned) +
+                m_vecdEdgeValues.size() * sizeof(double) +
+                m_vecusQuantizedEdgeValues.size() * sizeof(unsigned short);
+    }
+
+private:
+    void Initialize(const double &cdQuantizationRange)
+    {
+        CASSERT::ASSERT_CONDITION("CCompressedGraph::CCompressedGraph() parameter \"cdQuantizationRange\" out of range", cdQuantizationRange >= 0.0);
+
+        m_vecuEdgeOffsets.reserve(m_uNumberOfVertices + 1);
+        m_vecuByteOffsets.reserve(m_uNumberOfVertices + 1);
+        m_vecuEdgeOffsets.push_back(0);
+        m_vecuByteOffsets.push_back(0);
+        m_vecucBytes.resize(m_cuBytePadding, 0);
+    }
+
+    unsigned GetNumberOfAppendedVertices() const
+    {
+        return static_cast<unsigned>(m_vecuEdgeOffsets.size() - 1);
+    }
+
+    void EncodeNeighbors(const vector< pair<unsigned, double> > &vecNeighbors)
+    {
+        const size_t cstControlStart = m_vecucBytes.size();
+        m_vecucBytes.resize(cstControlStart + (vecNeighbors.size() + 3) / 4, 0);
+
+        unsigned uIndex = 0;
+        unsigned uPreviousNeighbor = 0;
+        vector< pair<unsigned, double> >::const_iterator ciNeighbor = vecNeighbors.begin();
+        while(ciNeighbor != vecNeighbors.end())
+        {
+            CASSERT::ASSERT_CONDITION("CCompressedGraph::AppendVertex() neighbor vertex out of range", ciNeighbor->first < m_uNumberOfVertices);
+            CASSERT::ASSERT_CONDITION("CCompressedGraph::AppendVertex() neighbors are not sorted", (uIndex == 0) || (ciNeighbor->first > uPreviousNeighbor));
+
+            unsigned uDelta = ciNeighbor->first - uPreviousNeighbor;
+            unsigned uLength = (uDelta < (1u << 8)) ? 1 : (uDelta < (1u << 16)) ? 2 : (uDelta < (1u << 24)) ? 3 : 4;
+            m_vecucBytes[cstControlStart + uIndex / 4] |= static_cast<unsigned char>((uLength - 1) << ((uIndex % 4) * 2));
+            for(unsigned uByte = 0; uByte < uLength; ++uByte)
+            {
+                m_vecucBytes.push_back(static_cast<unsigned char>(uDelta >> (8 * uByte)));
+            }
+            AddEdgeValue(ciNeighbor->second);
+
+            uPreviousNeighbor = ciNeighbor->first;
+            ++uIndex;
+            ++ciNeighbor;
+        }
+    }
+
+    void AddEdgeValue(const double &dValue)
+    {
+        if(m_bQuantized)
+        {
+            double dQuantizedValue = dValue / m_dQuantizationStep + 0.5;
+            CASSERT::ASSERT_CONDITION("CCompressedGraph::AddEdgeValue() edge value exceeds quantization range", (dValue >= 0.0) && (dQuantizedValue < m_cuMaxQuantizedValue + 1));
+            m_vecusQuantizedEdgeValues.push_back(static_cast<unsigned short>(dQuantizedValue));
+        }
+        else
+        {
+            m_vecdEdgeValues.push_back(dValue);
+        }
+    }
+
+    double GetEdgeValueAt(const unsigned &uEdge) const
+    {
+        if(m_bQuantized)
+        {
+            return m_vecusQuantizedEdgeValues[uEdge] * m_dQuantizationStep;
+        }
+        return m_vecdEdgeValues[uEdge];
+    }
+
+    const unsigned char *GetBytes() const
+    {
+        return &m_vecucBytes[0];
+    }
+
+    static const unsigned m_cuMaxQuantizedValue = 65535;
+    static const unsigned m_cuBytePadding = 16; // One SIMD register
+
+    unsigned m_uNumberOfVertices;
+    bool m_bQuantized;
+    double m_dQuantizationStep;
+    vector<unsigned> m_vecuEdgeOffsets; // First edge of every vertex (plus one past the last edge)
+    vector<unsigned> m_vecuByteOffsets; // First control byte of every vertex (plus one past the last byte)
+    vector<unsigned char> m_vecucBytes; // Encoded neighbors followed by padding
+    vector<double> m_vecdEdgeValues;
+    vector<unsigned short> m_vecusQuantizedEdgeValues;
+};
+
+
 // Utility class. Used as a container of pairs of double and unsigned values. First value (double) is a priority key
 // Uses "std::list" as a base container.
 class CPriorityQueue
@@ -343,10 +606,6 @@ class CGraphGenerator
 public:
     static CGraph RandomlyGenerateGraph(const unsigned &cuNumberOfVertices, const double &cdEdgeDensity, const double &cdDistanceRange)
     {
-        CASSERT::ASSERT_CONDITION("CGraphGenerator::RandomlyGenerateGraph() parameter \"cuNumberOfVertices\" out of range", ((cuNumberOfVertices>1) && (cuNumberOfVertices<=1000)) );
-        CASSERT::ASSERT_CONDITION("CGraphGenerator::RandomlyGenerateGraph() parameter \"cdEdgeDensity\" out of range", ((cdEdgeDensity>0.0) && (cdEdgeDensity<=1.0)) );
-        CASSERT::ASSERT_CONDITION("CGraphGenerator::RandomlyGenerateGraph() parameter \"cdDistanceRange\" out of range", ((cdDistanceRange>=m_cdMinimumDistance) && (cdDistanceRange<=m_cdMaximumDistance)) );
-
         static bool m_bRandomizerInitialized = false;
         if(!m_bRandomizerInitialized) // Randomizer initialized only ones
         {
@@ -354,6 +613,69 @@ public:
             m_bRandomizerInitialized = true;
         }
 
+        return GenerateGraph(cuNumberOfVertices, cdEdgeDensity, cdDistanceRange);
+    }
+
+    // Same as above, but randomizer is initialized with "cuSeed", so the same seed always gives the same graph.
+    static CGraph RandomlyGenerateGraph(const unsigned &cuNumberOfVertices, const double &cdEdgeDensity, const double &cdDistanceRange, const unsigned &cuSeed)
+    {
+        srand(cuSeed);
+        return GenerateGraph(cuNumberOfVertices, cdEdgeDensity, cdDistanceRange);
+    }
+
+    // Stops the program if "RandomlyGenerateGraph" can not generate a graph with these parameters.
+    static void CheckParameters(const unsigned &cuNumberOfVertices, const double &cdEdgeDensity, const double &cdDistanceRange)
+    {
+        CASSERT::ASSERT_CONDITION("CGraphGenerator::RandomlyGenerateGraph() parameter \"cuNumberOfVertices\" out of range", ((cuNumberOfVertices>1) && (cuNumberOfVertices<=1000)) );
+        CASSERT::ASSERT_CONDITION("CGraphGenerator::RandomlyGenerateGraph() parameter \"cdEdgeDensity\" out of range", ((cdEdgeDensity>0.0) && (cdEdgeDensity<=1.0)) );
+        CASSERT::ASSERT_CONDITION("CGraphGenerator::RandomlyGenerateGraph() parameter \"cdDistanceRange\" out of range", ((cdDistanceRange>=m_cdMinimumDistance) && (cdDistanceRange<=m_cdMaximumDistance)) );
+    }
+
+    // Generates compressed graph directly, vertex by vertex, so no "CGraph" is ever built and only the memory
+    // of the compressed graph is used. Edge and its distance are taken from a hash of the seed and both vertices,
+    // so every vertex is generated on its own. Takes O(V^2) time.
+    // Gives another graph than "RandomlyGenerateGraph" with the same seed.
+    static CCompressedGraph RandomlyGenerateCompressedGraph(const unsigned &cuNumberOfVertices, const double &cdEdgeDensity, const double &cdDistanceRange,
+                                                            const unsigned &cuSeed, const bool &cbQuantizeDistances = false)
+    {
+        CASSERT::ASSERT_CONDITION("CGraphGenerator::RandomlyGenerateCompressedGraph() parameter \"cuNumberOfVertices\" out of range", ((cuNumberOfVertices>1) && (cuNumberOfVertices<=m_cuMaxNumberOfVerticesInCompressedGraph)) );
+        CASSERT::ASSERT_CONDITION("CGraphGenerator::RandomlyGenerateCompressedGraph() parameter \"cdEdgeDensity\" out of range", ((cdEdgeDensity>0.0) && (cdEdgeDensity<=1.0)) );
+        CASSERT::ASSERT_CONDITION("CGraphGenerator::RandomlyGenerateCompressedGraph() parameter \"cdDistanceRange\" out of range", ((cdDistanceRange>=m_cdMinimumDistance) && (cdDistanceRange<=m_cdMaximumDistance)) );
+
+        const double cdHashRange = 4294967296.0; // 2^32
+        CCompressedGraph ResultGraph(cuNumberOfVertices, cbQuantizeDistances ? cdDistanceRange : 0.0);
+        vector< pair<unsigned, double> > vecNeighbors;
+        for(unsigned uVertex = 0; uVertex<cuNumberOfVertices; ++uVertex)
+        {
+            vecNeighbors.clear();
+            for(unsigned uNeighbor = 0; uNeighbor<cuNumberOfVertices; ++uNeighbor)
+            {
+                if(uNeighbor == uVertex) continue;
+                unsigned long long ullHash = HashOfVertexPair(cuSeed, min(uVertex, uNeighbor), max(uVertex, uNeighbor));
+                if( (ullHash & 0xFFFFFFFFull) < (cdEdgeDensity * cdHashRange) )
+                {
+                    double dGeneratedDistance = (ullHash >> 32)/cdHashRange*(cdDistanceRange-m_cdMinimumDistance) + m_cdMinimumDistance;
+                    vecNeighbors.push_back(make_pair(uNeighbor, dGeneratedDistance));
+                }
+            }
+            ResultGraph.AppendVertex(vecNeighbors);
+        }
+        return ResultGraph;
+    }
+private:
+    static unsigned long long HashOfVertexPair(const unsigned &cuSeed, const unsigned &cuLowerVertex, const unsigned &cuUpperVertex) // "SplitMix64" mixing.
+    {
+        unsigned long long ullHash = (static_cast<unsigned long long>(cuLowerVertex) << 32 | cuUpperVertex) ^ (cuSeed * 0x9E3779B97F4A7C15ull);
+        ullHash += 0x9E3779B97F4A7C15ull;
+        ullHash = (ullHash ^ (ullHash >> 30)) * 0xBF58476D1CE4E5B9ull;
+        ullHash = (ullHash ^ (ullHash >> 27)) * 0x94D049BB133111EBull;
+        return ullHash ^ (ullHash >> 31);
+    }
+
+    static CGraph GenerateGraph(const unsigned &cuNumberOfVertices, const double &cdEdgeDensity, const double &cdDistanceRange)
+    {
+        CheckParameters(cuNumberOfVertices, cdEdgeDensity, cdDistanceRange);
+
         CGraph ResultGraph(cuNumberOfVertices);
         for(unsigned uVertexFrom = 0; uVertexFrom<(cuNumberOfVertices - 1); ++uVertexFrom)
         {
@@ -368,9 +690,10 @@ public:
         }
         return ResultGraph;
     }
-private:
+
     static const double m_cdMinimumDistance;
     static const double m_cdMaximumDistance;
+    static const unsigned m_cuMaxNumberOfVerticesInCompressedGraph = 100000;
     CGraphGenerator();
 
 };
@@ -388,6 +711,83 @@ public:
 
         return CalculateAverageShortestPathLengthInGraph(Graph);
     }
+
+    static double SimulateOnGraph(const CCompressedGraph &Graph)
+    {
+        CASSERT::ASSERT_CONDITION("CMonteCarloSimulation::SimulateOnGraph() parameter \"Graph\" has no vertices", (1 <= Graph.GetNumberOfVertices()) );
+
+        return CalculateAverageShortestPathLengthInGraph(Graph);
+    }
+
+    // Dijkstra’s algoritm on a compressed graph. Graph is not changed, distances are returned in "vecdDistances".
+    // Unreachable vertices get "numeric_limits<double>::max()".
+    // If "uTargetVertex" is given, search stops as soon as its distance is final (other distances may be not final).
+    static void CalculateShortestPathLengthsInGraph(const CCompressedGraph &Graph, const unsigned &uStartingVertex, vector<double> &vecdDistances,
+                                                    const unsigned &uTargetVertex = numeric_limits<unsigned>::max())
+    {
+        CASSERT::ASSERT_CONDITION("CMonteCarloSimulation::CalculateShortestPathLengthsInGraph() parameter \"uStartingVertex\" out of range", uStartingVertex<Graph.GetNumberOfVertices());
+
+        unsigned uVertexNumber = Graph.GetNumberOfVertices();
+        vecdDistances.assign(uVertexNumber, numeric_limits<double>::max());
+        vector<bool> vecVertexVisited(uVertexNumber, false); // Vector to store "visited" status
+        // Binary heap of distance/vertex pairs. Instead of changing a priority, a new pair is added;
+        // outdated pairs are skipped when taken out (their vertex is already visited).
+        priority_queue< pair<double, unsigned>, vector< pair<double, unsigned> >, greater< pair<double, unsigned> > > PQ;
+
+        vecdDistances[uStartingVertex] = 0; // Starting vertex has value of 0
+        PQ.push(make_pair(0.0, uStartingVertex));
+
+        while(!PQ.empty())
+        {
+            unsigned uCurrentVertex = PQ.top().second;
+            PQ.pop();
+            if(vecVertexVisited[uCurrentVertex]) continue; // outdated pair
+            if(uCurrentVertex == uTargetVertex) break;
+            CCompressedGraph::CNeighborIterator iNeighbor = Graph.GetNeighborIterator(uCurrentVertex);
+            while(!iNeighbor.IsEnd()) // checking all neighbors
+            {
+                unsigned uNeighbor = iNeighbor.GetVertex();
+                if(!vecVertexVisited[uNeighbor])
+                {
+                    double dNewPossibleValue = vecdDistances[uCurrentVertex] + iNeighbor.GetEdgeValue();
+                    if( vecdDistances[uNeighbor] > dNewPossibleValue )
+                    {
+                        PQ.push(make_pair(dNewPossibleValue, uNeighbor)); // path to a new vertex or shorter path found
+                        vecdDistances[uNeighbor] = dNewPossibleValue;
+                    }
+                }
+                iNeighbor.Next();
+            }
+            vecVertexVisited[uCurrentVertex] = true;
+        }
+    }
+
+    static double CalculateAverageShortestPathLengthInGraph(const CCompressedGraph &Graph, const unsigned &uStartingVertex = 0)
+    {
+        double dResult = 0;
+        unsigned uNumberOfReachableElements = 0; // Needed to get average distance
+        vector<double> vecdDistances;
+        CalculateShortestPathLengthsInGraph(Graph, uStartingVertex, vecdDistances);
+
+        for(unsigned uVertex = 0; uVertex < vecdDistances.size(); ++uVertex)
+        {
+            if(vecdDistances[uVertex] != numeric_limits<double>::max())
+            {
+                dResult += vecdDistances[uVertex];
+                ++uNumberOfReachableElements;
+            }
+        }
+
+        if(1 == uNumberOfReachableElements) // excluding first element as it was our start point
+        {
+            dResult = 0; // No path from first vertex
+        }
+        else
+        {
+            dResult = dResult/(uNumberOfReachableElements-1); // Average distance
+        }
+        return dResult;
+    }
 private:
     static double CalculateAverageShortestPathLengthInGraph(CGraph &Graph, const unsigned &uStartingVertex = 0)
     {
@@ -446,13 +846,729 @@ private:
 };
 
 
-int main(void)
+// Parameters of a Monte Carlo campaign. Stored in the checkpoint file and compared on resume.
+struct SCampaignParameters
+{
+    SCampaignParameters(const unsigned &uNumberOfTrials = 0, const unsigned &uNumberOfVertices = 0,
+                        const double &dEdgeDensity = 0.0, const double &dDistanceRange = 0.0, const unsigned &uCampaignSeed = 0):
+        m_uNumberOfTrials(uNumberOfTrials), m_uNumberOfVertices(uNumberOfVertices),
+        m_dEdgeDensity(dEdgeDensity), m_dDistanceRange(dDistanceRange), m_uCampaignSeed(uCampaignSeed)
+    {}
+    unsigned m_uNumberOfTrials;
+    unsigned m_uNumberOfVertices;
+    double m_dEdgeDensity;
+    double m_dDistanceRange;
+    unsigned m_uCampaignSeed;
+};
+
+
+// Long Monte Carlo campaign with checkpoint/resume. Every trial generates its graph from its own seed
+// (derived from the campaign seed and the trial number), so any trial can be replayed alone with "ReplayTrial".
+// Partial aggregates and the next trial number are saved to a binary checkpoint file every "cuCheckpointInterval" trials.
+// Checkpoint is written to a temporary file and then renamed, so an interrupted write keeps the previous checkpoint.
+// Checkpoint layout (native byte order): "MCC1", parameters, next trial, sum, sum of squares, min, max, min trial, max trial.
+class CMonteCarloCampaign
+{
+public:
+    // Resumes the campaign from "strCheckpointFile" if it exists, otherwise starts it with "Parameters".
+    // Parameters with no trials mean "take everything from the checkpoint".
+    CMonteCarloCampaign(const string &strCheckpointFile, const SCampaignParameters &Parameters):
+        m_strCheckpointFile(strCheckpointFile), m_Parameters(Parameters), m_uNextTrial(1),
+        m_dSum(0.0), m_dSumOfSquares(0.0), m_dMin(numeric_limits<double>::max()), m_dMax(-numeric_limits<double>::max()),
+        m_uMinTrial(0), m_uMaxTrial(0)
+    {
+        m_bResumed = LoadCheckpoint();
+        CASSERT::ASSERT_CONDITION("CMonteCarloCampaign::CMonteCarloCampaign() no checkpoint to resume and parameter \"Parameters\" has no trials", m_Parameters.m_uNumberOfTrials >= 1);
+        CGraphGenerator::CheckParameters(m_Parameters.m_uNumberOfVertices, m_Parameters.m_dEdgeDensity, m_Parameters.m_dDistanceRange); // Before any checkpoint is written
+    }
+
+    static bool HasCheckpoint(const string &strCheckpointFile)
+    {
+        return static_cast<bool>(ifstream(strCheckpointFile.c_str(), ios::binary));
+    }
+
+    bool IsResumed() const
+    {
+        return m_bResumed;
+    }
+
+    unsigned GetNextTrial() const
+    {
+        return m_uNextTrial;
+    }
+
+    const SCampaignParameters &GetParameters() const
+    {
+        return m_Parameters;
+    }
+
+    void Run(ostream &osOutput, const unsigned &cuCheckpointInterval)
+    {
+        CASSERT::ASSERT_CONDITION("CMonteCarloCampaign::Run() parameter \"cuCheckpointInterval\" out of range", cuCheckpointInterval >= 1);
+
+        if(m_uNextTrial == 1)
+        {
+            SaveCheckpoint(); // Campaign can be resumed and replayed from the very start
+        }
+
+        while(m_uNextTrial <= m_Parameters.m_uNumberOfTrials)
+        {
+            unsigned uSeed = GetTrialSeed(m_Parameters.m_uCampaignSeed, m_uNextTrial);
+            double dResult = ReplayTrial(m_Parameters, m_uNextTrial);
+            osOutput << "Trial #" << m_uNextTrial << " seed " << uSeed << ": " << dResult << endl;
+
+            m_dSum += dResult;
+            m_dSumOfSquares += dResult * dResult;
+            if(dResult < m_dMin)
+            {
+                m_dMin = dResult;
+                m_uMinTrial = m_uNextTrial;
+            }
+            if(dResult > m_dMax)
+            {
+                m_dMax = dResult;
+                m_uMaxTrial = m_uNextTrial;
+            }
+            ++m_uNextTrial;
+
+            if( ((m_uNextTrial - 1) % cuCheckpointInterval == 0) || (m_uNextTrial > m_Parameters.m_uNumberOfTrials) )
+            {
+                SaveCheckpoint();
+            }
+        }
+
+        unsigned uNumberOfTrials = m_Parameters.m_uNumberOfTrials;
+        double dMean = m_dSum / uNumberOfTrials;
+        double dVariance = max(0.0, m_dSumOfSquares / uNumberOfTrials - dMean * dMean);
+        osOutput << "Campaign result over " << uNumberOfTrials << " trials: " << dMean << endl
+                 << "Standard deviation: " << sqrt(dVariance) << endl
+                 << "Minimum: " << m_dMin << " (trial #" << m_uMinTrial << ")" << endl
+                 << "Maximum: " << m_dMax << " (trial #" << m_uMaxTrial << ")" << endl;
+    }
+
+    // Runs one trial of the campaign on its own. Gives the same result as the trial inside the campaign.
+    static double ReplayTrial(const SCampaignParameters &Parameters, const unsigned &cuTrial)
+    {
+        CASSERT::ASSERT_CONDITION("CMonteCarloCampaign::ReplayTrial() parameter \"cuTrial\" out of range", (cuTrial >= 1) && (cuTrial <= Parameters.m_uNumberOfTrials));
+
+        CGraph Graph = CGraphGenerator::RandomlyGenerateGraph(Parameters.m_uNumberOfVertices, Parameters.m_dEdgeDensity, Parameters.m_dDistanceRange,
+                                                              GetTrialSeed(Parameters.m_uCampaignSeed, cuTrial));
+        return CMonteCarloSimulation::SimulateOnGraph(Graph);
+    }
+
+    static unsigned GetTrialSeed(const unsigned &cuCampaignSeed, const unsigned &cuTrial) // Mixes bits, so that close trials get unrelated seeds.
+    {
+        unsigned uSeed = cuCampaignSeed ^ (cuTrial * 0x9E3779B9u);
+        uSeed ^= uSeed >> 16;
+        uSeed *= 0x85EBCA6Bu;
+        uSeed ^= uSeed >> 13;
+        uSeed *= 0xC2B2AE35u;
+        uSeed ^= uSeed >> 16;
+        return uSeed;
+    }
+
+private:
+    bool LoadCheckpoint()
+    {
+        ifstream ifsCheckpoint(m_strCheckpointFile.c_str(), ios::binary);
+        if(!ifsCheckpoint) return false; // No checkpoint yet
+
+        char acMagic[4] = {0, 0, 0, 0};
+        ifsCheckpoint.read(acMagic, sizeof(acMagic));
+        CASSERT::ASSERT_CONDITION("CMonteCarloCampaign::LoadCheckpoint() file is not a campaign checkpoint", (ifsCheckpoint.gcount() == sizeof(acMagic)) && (string(acMagic, sizeof(acMagic)) == m_ccMagic));
+
+        SCampaignParameters Stored;
+        ReadValue(ifsCheckpoint, Stored.m_uNumberOfTrials);
+        ReadValue(ifsCheckpoint, Stored.m_uNumberOfVertices);
+        ReadValue(ifsCheckpoint, Stored.m_dEdgeDensity);
+        ReadValue(ifsCheckpoint, Stored.m_dDistanceRange);
+        ReadValue(ifsCheckpoint, Stored.m_uCampaignSeed);
+        ReadValue(ifsCheckpoint, m_uNextTrial);
+        ReadValue(ifsCheckpoint, m_dSum);
+        ReadValue(ifsCheckpoint, m_dSumOfSquares);
+        ReadValue(ifsCheckpoint, m_dMin);
+        ReadValue(ifsCheckpoint, m_dMax);
+        ReadValue(ifsCheckpoint, m_uMinTrial);
+        ReadValue(ifsCheckpoint, m_uMaxTrial);
+        CASSERT::ASSERT_CONDITION("CMonteCarloCampaign::LoadCheckpoint() checkpoint file is truncated", !ifsCheckpoint.fail());
+        CASSERT::ASSERT_CONDITION("CMonteCarloCampaign::LoadCheckpoint() checkpoint belongs to a campaign with other parameters",
+                                  (m_Parameters.m_uNumberOfTrials == 0) ||
+                                  ( (Stored.m_uNumberOfTrials == m_Parameters.m_uNumberOfTrials) &&
+                                    (Stored.m_uNumberOfVertices == m_Parameters.m_uNumberOfVertices) &&
+                                    (Stored.m_dEdgeDensity == m_Parameters.m_dEdgeDensity) &&
+                                    (Stored.m_dDistanceRange == m_Parameters.m_dDistanceRange) &&
+                                    (Stored.m_uCampaignSeed == m_Parameters.m_uCampaignSeed) ));
+        m_Parameters = Stored;
+        return true;
+    }
+
+    void SaveCheckpoint() const
+    {
+        string strTemporaryFile = m_strCheckpointFile + ".tmp";
+        {
+            ofstream ofsCheckpoint(strTemporaryFile.c_str(), ios::binary | ios::trunc);
+            ofsCheckpoint.write(m_ccMagic, 4);
+            WriteValue(ofsCheckpoint, m_Parameters.m_uNumberOfTrials);
+            WriteValue(ofsCheckpoint, m_Parameters.m_uNumberOfVertices);
+            WriteValue(ofsCheckpoint, m_Parameters.m_dEdgeDensity);
+            WriteValue(ofsCheckpoint, m_Parameters.m_dDistanceRange);
+            WriteValue(ofsCheckpoint, m_Parameters.m_uCampaignSeed);
+            WriteValue(ofsCheckpoint, m_uNextTrial);
+            WriteValue(ofsCheckpoint, m_dSum);
+            WriteValue(ofsCheckpoint, m_dSumOfSquares);
+            WriteValue(ofsCheckpoint, m_dMin);
+            WriteValue(ofsCheckpoint, m_dMax);
+            WriteValue(ofsCheckpoint, m_uMinTrial);
+            WriteValue(ofsCheckpoint, m_uMaxTrial);
+            ofsCheckpoint.flush();
+            CASSERT::ASSERT_CONDITION("CMonteCarloCampaign::SaveCheckpoint() cannot write checkpoint file", ofsCheckpoint.good());
+        }
+        CASSERT::ASSERT_CONDITION("CMonteCarloCampaign::SaveCheckpoint() cannot replace checkpoint file", rename(strTemporaryFile.c_str(), m_strCheckpointFile.c_str()) == 0);
+    }
+
+    template<typename T>
+    static void ReadValue(istream &isInput, T &Value)
+    {
+        isInput.read(reinterpret_cast<char *>(&Value), sizeof(Value));
+    }
+
+    template<typename T>
+    static void WriteValue(ostream &osOutput, const T &Value)
+    {
+        osOutput.write(reinterpret_cast<const char *>(&Value), sizeof(Value));
+    }
+
+    static const char *const m_ccMagic;
+
+    string m_strCheckpointFile;
+    SCampaignParameters m_Parameters;
+    bool m_bResumed;
+    unsigned m_uNextTrial; // Trials are numbered from 1
+    double m_dSum;
+    double m_dSumOfSquares;
+    double m_dMin;
+    double m_dMax;
+    unsigned m_uMinTrial;
+    unsigned m_uMaxTrial;
+};
+const char *const CMonteCarloCampaign::m_ccMagic = "MCC1";
+
+
+// Query of the shortest-path service. One query is read from one input line.
+struct SQuery
+{
+    enum EType
+    {
+        eSingleSourceShortestPaths, // "sssp <source>" - distances to all vertices
+        eAveragePathLength,         // "avg <source>" - average shortest path from the source
+        eSourceTargetPathLength,    // "path <source> <target>" - shortest path between two vertices
+        eStatistics,                // "stats" - latency/throughput report
+        eError                      // line that could not be parsed
+    };
+
+    SQuery(const unsigned &uId = 0, const EType &eType = eError, const unsigned &uSource = 0, const unsigned &uTarget = 0):
+        m_uId(uId), m_eType(eType), m_uSource(uSource), m_uTarget(uTarget), m_tpReceived(chrono::steady_clock::now())
+    {}
+    unsigned m_uId;
+    EType m_eType;
+    unsigned m_uSource;
+    unsigned m_uTarget;
+    chrono::steady_clock::time_point m_tpReceived;
+    string m_strResult;
+};
+
+
+// Utility class. Thread-safe FIFO of queries. Queries are taken out in batches.
+// Uses "std::deque" as a base container.
+class CQueryQueue
+{
+public:
+    CQueryQueue():
+        m_bClosed(false)
+    {}
+
+    void AddQuery(const SQuery &Query)
+    {
+        lock_guard<mutex> Lock(m_Mutex);
+        m_dequeQueries.push_back(Query);
+        m_cvQueryAdded.notify_one();
+    }
+
+    void Close() // No more queries will be added.
+    {
+        lock_guard<mutex> Lock(m_Mutex);
+        m_bClosed = true;
+        m_cvQueryAdded.notify_one();
+    }
+
+    // Waits for at least one query and takes out all queued queries (but not more than "cuMaxBatchSize").
+    // Returns false if queue is closed and empty.
+    bool GetBatch(vector<SQuery> &vecBatch, const unsigned &cuMaxBatchSize)
+    {
+        unique_lock<mutex> Lock(m_Mutex);
+        while(m_dequeQueries.empty() && !m_bClosed)
+        {
+            m_cvQueryAdded.wait(Lock);
+        }
+
+        vecBatch.clear();
+        while(!m_dequeQueries.empty() && (vecBatch.size() < cuMaxBatchSize))
+        {
+            vecBatch.push_back(m_dequeQueries.front());
+            m_dequeQueries.pop_front();
+        }
+        return !vecBatch.empty();
+    }
+
+private:
+    mutex m_Mutex;
+    condition_variable m_cvQueryAdded;
+    deque<SQuery> m_dequeQueries;
+    bool m_bClosed;
+};
+
+
+// Fixed pool of worker threads. Runs batches of queries on a read-only "CCompressedGraph".
+// Workers take queries of the current batch one by one until the batch is over.
+class CQueryWorkerPool
+{
+public:
+    CQueryWorkerPool(const CCompressedGraph &Graph, const unsigned &cuNumberOfWorkers):
+        m_Graph(Graph), m_pBatch(NULL), m_uNextQuery(0), m_uBusyWorkers(0), m_uGeneration(0), m_bStop(false)
+    {
+        CASSERT::ASSERT_CONDITION("CQueryWorkerPool::CQueryWorkerPool() parameter \"cuNumberOfWorkers\" out of range", cuNumberOfWorkers >= 1);
+
+        for(unsigned uWorker = 0; uWorker < cuNumberOfWorkers; ++uWorker)
+        {
+            m_vecWorkers.push_back(thread(&CQueryWorkerPool::WorkerLoop, this));
+        }
+    }
+
+    ~CQueryWorkerPool()
+    {
+        {
+            lock_guard<mutex> Lock(m_Mutex);
+            m_bStop = true;
+            m_cvBatchStarted.notify_all();
+        }
+        for(unsigned uWorker = 0; uWorker < m_vecWorkers.size(); ++uWorker)
+        {
+            m_vecWorkers[uWorker].join();
+        }
+    }
+
+    void RunBatch(vector<SQuery> &vecBatch) // Returns when all queries of the batch have results.
+    {
+        unique_lock<mutex> Lock(m_Mutex);
+        m_pBatch = &vecBatch;
+        m_uNextQuery = 0;
+        m_uBusyWorkers = static_cast<unsigned>(m_vecWorkers.size());
+        ++m_uGeneration;
+        m_cvBatchStarted.notify_all();
+        while(m_uBusyWorkers != 0)
+        {
+            m_cvBatchFinished.wait(Lock);
+        }
+        m_pBatch = NULL;
+    }
+
+private:
+    void WorkerLoop()
+    {
+        unsigned uGeneration = 0;
+        vector<double> vecdDistances; // Reused between queries
+        while(true)
+        {
+            vector<SQuery> *pBatch = NULL;
+            {
+                unique_lock<mutex> Lock(m_Mutex);
+                while(!m_bStop && (uGeneration == m_uGeneration))
+                {
+                    m_cvBatchStarted.wait(Lock);
+                }
+                if(m_bStop) return;
+                uGeneration = m_uGeneration;
+                pBatch = m_pBatch;
+            }
+
+            unsigned uQuery = m_uNextQuery++;
+            while(uQuery < pBatch->size())
+            {
+                RunQuery((*pBatch)[uQuery], vecdDistances);
+                uQuery = m_uNextQuery++;
+            }
+
+            lock_guard<mutex> Lock(m_Mutex);
+            if(--m_uBusyWorkers == 0)
+            {
+                m_cvBatchFinished.notify_one();
+            }
+        }
+    }
+
+    void RunQuery(SQuery &Query, vector<double> &vecdDistances) const
+    {
+        ostringstream ossResult;
+        switch(Query.m_eType)
+        {
+        case SQuery::eSingleSourceShortestPaths:
+            CMonteCarloSimulation::CalculateShortestPathLengthsInGraph(m_Graph, Query.m_uSource, vecdDistances);
+            for(unsigned uVertex = 0; uVertex < vecdDistances.size(); ++uVertex)
+            {
+                ossResult << (uVertex ? " " : "");
+                WriteDistance(ossResult, vecdDistances[uVertex]);
+            }
+            break;
+        case SQuery::eAveragePathLength:
+            ossResult << CMonteCarloSimulation::CalculateAverageShortestPathLengthInGraph(m_Graph, Query.m_uSource);
+            break;
+        case SQuery::eSourceTargetPathLength:
+            CMonteCarloSimulation::CalculateShortestPathLengthsInGraph(m_Graph, Query.m_uSource, vecdDistances, Query.m_uTarget);
+            WriteDistance(ossResult, vecdDistances[Query.m_uTarget]);
+            break;
+        default: // Statistics and errors are made by the service itself
+            return;
+        }
+        Query.m_strResult = ossResult.str();
+    }
+
+    static void WriteDistance(ostream &osOutput, const double &dDistance)
+    {
+        if(dDistance == numeric_limits<double>::max())
+        {
+            osOutput << "inf"; // Vertex is unreachable
+        }
+        else
+        {
+            osOutput << dDistance;
+        }
+    }
+
+    const CCompressedGraph &m_Graph;
+    vector<thread> m_vecWorkers;
+    mutex m_Mutex;
+    condition_variable m_cvBatchStarted;
+    condition_variable m_cvBatchFinished;
+    vector<SQuery> *m_pBatch;
+    atomic<unsigned> m_uNextQuery;
+    unsigned m_uBusyWorkers;
+    unsigned m_uGeneration;
+    bool m_bStop;
+};
+
+
+// Utility class. Keeps receive/answer times of the last answered queries in a fixed ring buffer,
+// so memory and the cost of a report do not grow while the service runs.
+class CLatencyWindow
+{
+public:
+    explicit CLatencyWindow(const unsigned &cuCapacity):
+        m_vecAnsweredQueries(cuCapacity), m_uNext(0), m_uSize(0)
+    {
+        CASSERT::ASSERT_CONDITION("CLatencyWindow::CLatencyWindow() parameter \"cuCapacity\" out of range", cuCapacity >= 1);
+    }
+
+    void AddQuery(const chrono::steady_clock::time_point &tpReceived, const chrono::steady_clock::time_point &tpAnswered)
+    {
+        m_vecAnsweredQueries[m_uNext] = SAnsweredQuery(tpReceived, tpAnswered);
+        m_uNext = (m_uNext + 1) % m_vecAnsweredQueries.size();
+        m_uSize = min(m_uSize + 1, static_cast<unsigned>(m_vecAnsweredQueries.size()));
+    }
+
+    unsigned GetSize() const // Returns the number of queries in the window.
+    {
+        return m_uSize;
+    }
+
+    double GetLatencyPercentile(const unsigned &cuPercent) const // Microseconds from receiving a query to answering it.
+    {
+        if(m_uSize == 0) return 0.0;
+
+        vector<double> vecdLatencies;
+        vecdLatencies.reserve(m_uSize);
+        for(unsigned uQuery = 0; uQuery < m_uSize; ++uQuery)
+        {
+            const SAnsweredQuery &Query = m_vecAnsweredQueries[uQuery];
+            vecdLatencies.push_back(chrono::duration<double, micro>(Query.m_tpAnswered - Query.m_tpReceived).count());
+        }
+        vector<double>::iterator iPercentile = vecdLatencies.begin() + (m_uSize - 1) * cuPercent / 100;
+        nth_element(vecdLatencies.begin(), iPercentile, vecdLatencies.end());
+        return *iPercentile;
+    }
+
+    double GetThroughput() const // Queries per second from receiving the oldest query of the window to answering the newest one.
+    {
+        if(m_uSize == 0) return 0.0;
+
+        unsigned uOldest = (m_uSize < m_vecAnsweredQueries.size()) ? 0 : m_uNext; // Queries are answered in the order they are received
+        unsigned uNewest = (m_uNext + m_vecAnsweredQueries.size() - 1) % m_vecAnsweredQueries.size();
+        double dSeconds = chrono::duration<double>(m_vecAnsweredQueries[uNewest].m_tpAnswered - m_vecAnsweredQueries[uOldest].m_tpReceived).count();
+        return (dSeconds > 0.0) ? m_uSize / dSeconds : 0.0;
+    }
+
+private:
+    struct SAnsweredQuery
+    {
+        SAnsweredQuery(const chrono::steady_clock::time_point &tpReceived = chrono::steady_clock::time_point(),
+                       const chrono::steady_clock::time_point &tpAnswered = chrono::steady_clock::time_point()):
+            m_tpReceived(tpReceived), m_tpAnswered(tpAnswered)
+        {}
+        chrono::steady_clock::time_point m_tpReceived;
+        chrono::steady_clock::time_point m_tpAnswered;
+    };
+    vector<SAnsweredQuery> m_vecAnsweredQueries;
+    unsigned m_uNext;
+    unsigned m_uSize;
+};
+
+
+// Resident shortest-path service. Graph is built once, then queries are read from the input stream line by line:
+//   sssp <source>           -> "<id> sssp <distance to vertex 0> ... <distance to vertex N-1>"
+//   avg <source>            -> "<id> avg <average shortest path from source>"
+//   path <source> <target>  -> "<id> path <shortest path from source to target>"
+//   stats                   -> "stats queries=... batches=... window=... p50_us=... p99_us=... throughput_qps=..."
+//   quit (or end of input)  -> final "stats" line, service stops
+// Unreachable vertices are reported as "inf". Latencies and throughput are taken over the last "m_cuLatencyWindowSize"
+// answered queries. Calling thread reads and queues queries, dispatcher thread takes them out in batches and runs
+// every batch on the worker pool. Responses are written in the order of queries.
+class CShortestPathService
+{
+public:
+    CShortestPathService(const CCompressedGraph &Graph, const unsigned &cuNumberOfWorkers, const unsigned &cuMaxBatchSize):
+        m_Graph(Graph), m_WorkerPool(Graph, cuNumberOfWorkers), m_cuMaxBatchSize(cuMaxBatchSize), m_uNumberOfBatches(0),
+        m_uNumberOfAnsweredQueries(0), m_LatencyWindow(m_cuLatencyWindowSize)
+    {
+        CASSERT::ASSERT_CONDITION("CShortestPathService::CShortestPathService() parameter \"cuMaxBatchSize\" out of range", cuMaxBatchSize >= 1);
+    }
+
+    void Run(istream &isInput, ostream &osOutput)
+    {
+        osOutput << "ready vertices=" << m_Graph.GetNumberOfVertices() << " edges=" << m_Graph.GetNumberOfEdges()
+                 << " memory_bytes=" << m_Graph.GetMemoryUsage() << endl;
+
+        thread Dispatcher(&CShortestPathService::DispatchQueries, this, ref(osOutput));
+        ReadQueries(isInput);
+        Dispatcher.join();
+
+        osOutput << FormatStatistics() << endl;
+    }
+
+private:
+    void ReadQueries(istream &isInput)
+    {
+        unsigned uNextId = 1;
+        string strLine;
+        while(getline(isInput, strLine))
+        {
+            istringstream issLine(strLine);
+            string strCommand;
+            if(!(issLine >> strCommand)) continue; // Empty line
+            if(strCommand == "quit") break;
+
+            SQuery Query(uNextId++, SQuery::eError);
+            unsigned uNumberOfVertices = m_Graph.GetNumberOfVertices();
+            bool bParsed = false;
+            if(strCommand == "stats")
+            {
+                Query.m_eType = SQuery::eStatistics;
+                bParsed = true;
+            }
+            else if( (strCommand == "sssp") || (strCommand == "avg") )
+            {
+                Query.m_eType = (strCommand == "sssp") ? SQuery::eSingleSourceShortestPaths : SQuery::eAveragePathLength;
+                bParsed = (issLine >> Query.m_uSource) && (Query.m_uSource < uNumberOfVertices);
+            }
+            else if(strCommand == "path")
+            {
+                Query.m_eType = SQuery::eSourceTargetPathLength;
+                bParsed = (issLine >> Query.m_uSource >> Query.m_uTarget) &&
+                        (Query.m_uSource < uNumberOfVertices) && (Query.m_uTarget < uNumberOfVertices);
+            }
+
+            string strRest;
+            if(!bParsed || (issLine >> strRest))
+            {
+                Query.m_eType = SQuery::eError;
+                Query.m_strResult = "cannot parse \"" + strLine + "\"";
+            }
+            m_QueryQueue.AddQuery(Query);
+        }
+        m_QueryQueue.Close();
+    }
+
+    void DispatchQueries(ostream &osOutput)
+    {
+        vector<SQuery> vecBatch;
+        while(m_QueryQueue.GetBatch(vecBatch, m_cuMaxBatchSize))
+        {
+            m_WorkerPool.RunBatch(vecBatch);
+            ++m_uNumberOfBatches;
+
+            for(unsigned uQuery = 0; uQuery < vecBatch.size(); ++uQuery)
+            {
+                const SQuery &Query = vecBatch[uQuery];
+                switch(Query.m_eType)
+                {
+                case SQuery::eStatistics:
+                    osOutput << FormatStatistics() << '\n';
+                    break;
+                case SQuery::eError:
+                    osOutput << Query.m_uId << " error " << Query.m_strResult << '\n';
+                    break;
+                default:
+                    osOutput << Query.m_uId << ' ' << GetCommandName(Query.m_eType) << ' ' << Query.m_strResult << '\n';
+                    m_LatencyWindow.AddQuery(Query.m_tpReceived, chrono::steady_clock::now());
+                    ++m_uNumberOfAnsweredQueries;
+                }
+            }
+            osOutput.flush();
+        }
+    }
+
+    string FormatStatistics() const
+    {
+        ostringstream ossStatistics;
+        ossStatistics << "stats queries=" << m_uNumberOfAnsweredQueries << " batches=" << m_uNumberOfBatches
+                      << " window=" << m_LatencyWindow.GetSize()
+                      << " p50_us=" << m_LatencyWindow.GetLatencyPercentile(50) << " p99_us=" << m_LatencyWindow.GetLatencyPercentile(99)
+                      << " throughput_qps=" << m_LatencyWindow.GetThroughput();
+        return ossStatistics.str();
+    }
+
+    static const char *GetCommandName(const SQuery::EType &eType)
+    {
+        switch(eType)
+        {
+        case SQuery::eSingleSourceShortestPaths: return "sssp";
+        case SQuery::eAveragePathLength: return "avg";
+        case SQuery::eSourceTargetPathLength: return "path";
+        default: return "";
+        }
+    }
+
+    const CCompressedGraph &m_Graph;
+    CQueryQueue m_QueryQueue;
+    CQueryWorkerPool m_WorkerPool;
+    const unsigned m_cuMaxBatchSize;
+    unsigned m_uNumberOfBatches;
+    unsigned m_uNumberOfAnsweredQueries;
+    CLatencyWindow m_LatencyWindow;
+    static const unsigned m_cuLatencyWindowSize = 4096;
+};
+const unsigned CShortestPathService::m_cuLatencyWindowSize;
+
+
+// Utility functions for command line. Return false if the whole text is not a number.
+bool ParseUnsigned(const char *ccText, unsigned &uValue)
+{
+    char *pcEnd = NULL;
+    unsigned long ulValue = strtoul(ccText, &pcEnd, 10);
+    if( (*ccText == '\0') || (*ccText == '-') || (*pcEnd != '\0') || (ulValue > numeric_limits<unsigned>::max()) ) return false;
+    uValue = static_cast<unsigned>(ulValue);
+    return true;
+}
+
+bool ParseDouble(const char *ccText, double &dValue)
+{
+    char *pcEnd = NULL;
+    dValue = strtod(ccText, &pcEnd);
+    return (*ccText != '\0') && (*pcEnd == '\0');
+}
+
+
+// Usage:
+//   HomeWork2                                                      - runs Monte Carlo simulation
+//   HomeWork2 --serve [vertices [density [range [workers [batch]]]]] - runs shortest-path service on stdin/stdout
+//   HomeWork2 --campaign <checkpoint> [trials vertices density range seed] - starts or resumes Monte Carlo campaign
+//   HomeWork2 --replay <checkpoint> <trial>                        - replays one trial of a campaign
+//   HomeWork2 --replay <trial> <vertices> <density> <range> <seed> - replays one trial without a checkpoint
+int main(int argc, char *argv[])
 {
     const unsigned cuNumOfSimulations = 10;
     const unsigned cuNumOfVerticesInGraph = 50;
     const double cdEdgesDensityInGraph = 0.2;
     const double cdRangeDistanceInGraph = 10.0;
 
+    if( (argc > 1) && (string(argv[1]) == "--serve") )
+    {
+        const unsigned cuMaxNumOfWorkers = 256;
+        const unsigned cuMaxBatchSize = 65536;
+        unsigned uNumOfVertices = cuNumOfVerticesInGraph;
+        double dEdgesDensity = cdEdgesDensityInGraph;
+        double dRangeDistance = cdRangeDistanceInGraph;
+        unsigned uNumOfWorkers = min(cuMaxNumOfWorkers, max(1u, thread::hardware_concurrency()));
+        unsigned uMaxBatchSize = 64;
+        CASSERT::ASSERT_CONDITION("usage: --serve [vertices [density [range [workers [batch]]]]]", argc <= 7);
+        CASSERT::ASSERT_CONDITION("usage: --serve \"vertices\" must be a number", (argc <= 2) || ParseUnsigned(argv[2], uNumOfVertices));
+        CASSERT::ASSERT_CONDITION("usage: --serve \"density\" must be a number", (argc <= 3) || ParseDouble(argv[3], dEdgesDensity));
+        CASSERT::ASSERT_CONDITION("usage: --serve \"range\" must be a number", (argc <= 4) || ParseDouble(argv[4], dRangeDistance));
+        CASSERT::ASSERT_CONDITION("usage: --serve \"workers\" must be from 1 to 256", (argc <= 5) ||
+                                  (ParseUnsigned(argv[5], uNumOfWorkers) && (uNumOfWorkers >= 1) && (uNumOfWorkers <= cuMaxNumOfWorkers)));
+        CASSERT::ASSERT_CONDITION("usage: --serve \"batch\" must be from 1 to 65536", (argc <= 6) ||
+                                  (ParseUnsigned(argv[6], uMaxBatchSize) && (uMaxBatchSize >= 1) && (uMaxBatchSize <= cuMaxBatchSize)));
+
+        CCompressedGraph Graph(CGraphGenerator::RandomlyGenerateCompressedGraph(uNumOfVertices, dEdgesDensity, dRangeDistance, static_cast<unsigned>(time(NULL))));
+        CShortestPathService Service(Graph, uNumOfWorkers, uMaxBatchSize);
+        Service.Run(cin, cout);
+        return 0;
+    }
+
+    if( (argc > 1) && (string(argv[1]) == "--campaign") )
+    {
+        CASSERT::ASSERT_CONDITION("usage: --campaign <checkpoint> [trials vertices density range seed]", (argc == 3) || (argc == 8));
+        CASSERT::ASSERT_CONDITION("main() no checkpoint to resume, campaign parameters are needed", (argc == 8) || CMonteCarloCampaign::HasCheckpoint(argv[2]));
+
+        const unsigned cuCheckpointInterval = 10;
+        SCampaignParameters Parameters;
+        if(argc == 8)
+        {
+            CASSERT::ASSERT_CONDITION("usage: --campaign parameters must be numbers, \"trials\" at least 1",
+                                      ParseUnsigned(argv[3], Parameters.m_uNumberOfTrials) && (Parameters.m_uNumberOfTrials >= 1) &&
+                                      ParseUnsigned(argv[4], Parameters.m_uNumberOfVertices) && ParseDouble(argv[5], Parameters.m_dEdgeDensity) &&
+                                      ParseDouble(argv[6], Parameters.m_dDistanceRange) && ParseUnsigned(argv[7], Parameters.m_uCampaignSeed));
+        }
+
+        CMonteCarloCampaign Campaign(argv[2], Parameters);
+        const SCampaignParameters &Used = Campaign.GetParameters();
+        cout << "Monte Carlo campaign." << endl
+             << "Number of trials: " << Used.m_uNumberOfTrials << ", campaign seed: " << Used.m_uCampaignSeed << endl
+             << "Number of vertices in graph: " << Used.m_uNumberOfVertices << endl
+             << "Distance range in graph: 1.0 to " << Used.m_dDistanceRange << endl
+             << "Edge density in graph: " << Used.m_dEdgeDensity << endl;
+        if(Campaign.IsResumed())
+        {
+            cout << "Resumed from checkpoint at trial #" << Campaign.GetNextTrial() << endl;
+        }
+        Campaign.Run(cout, cuCheckpointInterval);
+        return 0;
+    }
+
+    if( (argc > 1) && (string(argv[1]) == "--replay") )
+    {
+        CASSERT::ASSERT_CONDITION("usage: --replay <checkpoint> <trial> or --replay <trial> <vertices> <density> <range> <seed>", (argc == 4) || (argc == 7));
+
+        unsigned uTrial = 0;
+        SCampaignParameters Parameters;
+        if(argc == 4)
+        {
+            CASSERT::ASSERT_CONDITION("main() no checkpoint to replay from", CMonteCarloCampaign::HasCheckpoint(argv[2]));
+            CMonteCarloCampaign Campaign(argv[2], SCampaignParameters());
+            Parameters = Campaign.GetParameters();
+            uTrial = static_cast<unsigned>(atoi(argv[3]));
+        }
+        else
+        {
+            uTrial = static_cast<unsigned>(atoi(argv[2]));
+            Parameters = SCampaignParameters(uTrial, static_cast<unsigned>(atoi(argv[3])),
+                                             atof(argv[4]), atof(argv[5]), static_cast<unsigned>(strtoul(argv[6], NULL, 10)));
+        }
+
+        double dResult = CMonteCarloCampaign::ReplayTrial(Parameters, uTrial);
+        cout << "Replay of trial #" << uTrial << " seed " << CMonteCarloCampaign::GetTrialSeed(Parameters.m_uCampaignSeed, uTrial)
+             << ": " << dResult << endl;
+        return 0;
+    }
+
     cout << "Monte Carlo simulation." << endl
          << "Calculation of an average shortest path in randomly generated graph." << endl
          << "Number of vertices in graph: " << cuNumOfVerticesInGraph << endl